@@ -0,0 +1,210 @@
+#include "sharded_hashtable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+
+// Number of distinct keys each writer thread cycles through
+#define WRITER_SPAN 65536
+
+// Run lookup rounds over kvs split across the reader threads of the enclosing
+// parallel region (reader ids 0 .. num_readers - 1) and count wrong results
+static unsigned long reader_lookups(ShardedHashtable* ht, KeyValue* kvs, unsigned int numkvs, value_t* expected,
+                                    int reader, int num_readers, int rounds) {
+    unsigned int chunk = (numkvs + num_readers - 1) / num_readers;
+    unsigned int begin = reader * chunk;
+    unsigned int end = begin + chunk < numkvs ? begin + chunk : numkvs;
+    unsigned long mismatches = 0;
+
+    for (int r = 0; r < rounds; ++r) {
+        for (unsigned int i = begin; i < end; ++i) {
+            if (sharded_hashtable_lookup(ht, kvs[i].key) != expected[i]) {
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+// Insert, check, delete and re-check keys in [base, base + span) until the
+// readers finish; returns the number of wrong results
+static unsigned long writer_updates(ShardedHashtable* ht, hash_key_t base, unsigned int span,
+                                   int* readers_done, int num_readers, unsigned long* ops) {
+    unsigned long mismatches = 0;
+    unsigned long count = 0;
+
+    while (__atomic_load_n(readers_done, __ATOMIC_ACQUIRE) < num_readers) {
+        hash_key_t key = (hash_key_t)(base + (count % span));
+        value_t value = (value_t)(count + 1);
+        sharded_hashtable_insert(ht, key, value);
+        if (sharded_hashtable_lookup(ht, key) != value) {
+            mismatches++;
+        }
+        sharded_hashtable_delete(ht, key);
+        if (sharded_hashtable_lookup(ht, key) != (value_t)0) {
+            mismatches++;
+        }
+        count++;
+    }
+    *ops = count;
+    return mismatches;
+}
+
+// Time lookups, optionally with a dedicated thread rebuilding shards in a loop
+// and writer threads updating keys disjoint from the looked-up ones
+static double timed_lookups(ShardedHashtable* ht, KeyValue* kvs, unsigned int numkvs, value_t* expected,
+                            int num_readers, int rounds, int rebuild, int num_writers, hash_key_t writer_base,
+                            unsigned long* mismatches, unsigned long* writer_mismatches,
+                            unsigned long* rebuilds, unsigned long* writer_ops) {
+    int readers_done = 0;
+    unsigned long total_mismatches = 0;
+    unsigned long total_writer_mismatches = 0;
+    unsigned long total_rebuilds = 0;
+    unsigned long total_writer_ops = 0;
+    int rebuild_tid = rebuild ? num_readers : -1;
+    int first_writer_tid = num_readers + (rebuild ? 1 : 0);
+    double start = omp_get_wtime();
+
+    #pragma omp parallel num_threads(first_writer_tid + num_writers) \
+        reduction(+:total_mismatches, total_writer_mismatches, total_writer_ops)
+    {
+        int tid = omp_get_thread_num();
+        if (tid == rebuild_tid) {
+            // Background rebuild: rehash every shard in turn with a new seed,
+            // alternately growing and shrinking it
+            unsigned int num_shards = sharded_hashtable_num_shards(ht);
+            uint64_t seed = 1;
+            while (__atomic_load_n(&readers_done, __ATOMIC_ACQUIRE) < num_readers) {
+                unsigned int shard = (unsigned int)(total_rebuilds % num_shards);
+                unsigned long pass = total_rebuilds / num_shards;
+                size_t capacity = sharded_hashtable_shard_capacity(ht, shard);
+                size_t new_capacity = (pass % 2 == 0) ? capacity * 2 : capacity / 2;
+                sharded_hashtable_rebuild_shard(ht, shard, new_capacity, seed++);
+                total_rebuilds++;
+            }
+        } else if (tid >= first_writer_tid) {
+            unsigned long ops = 0;
+            hash_key_t base = (hash_key_t)(writer_base + (tid - first_writer_tid) * WRITER_SPAN);
+            total_writer_mismatches += writer_updates(ht, base, WRITER_SPAN, &readers_done, num_readers, &ops);
+            total_writer_ops += ops;
+        } else {
+            total_mismatches += reader_lookups(ht, kvs, numkvs, expected, tid, num_readers, rounds);
+            __atomic_fetch_add(&readers_done, 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    double end = omp_get_wtime();
+    *mismatches = total_mismatches;
+    *writer_mismatches = total_writer_mismatches;
+    *rebuilds = total_rebuilds;
+    *writer_ops = total_writer_ops;
+    return end - start;
+}
+
+int main(int argc, char* argv[]) {
+    // Number of keys for benchmarking
+    unsigned int numkvs = 10000000;
+    int num_threads = 4;  // Default to 4 reader threads
+    unsigned int num_shards = 64;
+    int num_writers = 1;
+    int rounds = 5;
+
+    if (argc > 1) {
+        numkvs = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        num_threads = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        num_shards = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        num_writers = atoi(argv[4]);
+    }
+    if (num_writers > 0 && sizeof(hash_key_t) < sizeof(uint32_t)) {
+        // Narrow keys leave no range disjoint from the looked-up keys
+        printf("Writer threads need KEY_T=uint32_t; running without writers\n");
+        num_writers = 0;
+    }
+
+    omp_set_num_threads(num_threads);
+
+    printf("Benchmarking Sharded Hash Table Lookups During Online Rebuild\n");
+    printf("Number of Key-Value Pairs: %u\n\n", numkvs);
+    printf("Number of Reader Threads: %d\n", num_threads);
+    printf("Number of Writer Threads: %d\n\n", num_writers);
+
+    // Twice the pairs so each shard stays at most half full
+    size_t capacity = next_power_of_two(numkvs) * 2;
+    ShardedHashtable* ht = initialize_sharded_hashtable(num_shards, capacity);
+    printf("Hash Table Capacity: %zu\n", capacity);
+    printf("Number of Shards: %u\n\n", sharded_hashtable_num_shards(ht));
+
+    // Generate test data
+    KeyValue* kvs = generate_kv_pairs(numkvs, capacity);
+    for (unsigned int i = 0; i < numkvs; ++i) {
+        if (kvs[i].key == K_TOMBSTONE) {
+            kvs[i].key -= 1; // Avoid K_TOMBSTONE
+        }
+    }
+    value_t* expected = (value_t*)malloc(sizeof(value_t) * numkvs);
+    if (!expected) {
+        perror("Failed to allocate lookup results");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Populating hash table...\n");
+    sharded_hashtable_insert_batch(ht, kvs, numkvs);
+    // Duplicate keys keep whichever value was written last
+    sharded_hashtable_lookup_batch(ht, kvs, numkvs, expected);
+    printf("Population complete.\n\n");
+
+    unsigned long mismatches = 0;
+    unsigned long writer_mismatches = 0;
+    unsigned long rebuilds = 0;
+    unsigned long writer_ops = 0;
+    double lookups = (double)numkvs * rounds;
+    // Generated keys are below capacity / 2, so writers start at capacity
+    hash_key_t writer_base = (hash_key_t)capacity;
+
+    // ------ Lookup Only ------ //
+    printf("Starting Lookup (Readers Only)...\n");
+    double readers_time = timed_lookups(ht, kvs, numkvs, expected, num_threads, rounds, 0, 0, writer_base,
+                                        &mismatches, &writer_mismatches, &rebuilds, &writer_ops);
+    printf("Lookup Time (Readers Only): %f seconds\n", readers_time);
+    printf("Lookup Mismatches (Readers Only): %lu\n\n", mismatches);
+
+    // ------ Lookup With Writers ------ //
+    printf("Starting Lookup (With Writers)...\n");
+    double writers_time = timed_lookups(ht, kvs, numkvs, expected, num_threads, rounds, 0, num_writers, writer_base,
+                                        &mismatches, &writer_mismatches, &rebuilds, &writer_ops);
+    printf("Lookup Time (With Writers): %f seconds\n", writers_time);
+    printf("Lookup Mismatches (With Writers): %lu\n", mismatches);
+    printf("Writer Updates Completed (With Writers): %lu\n", writer_ops);
+    printf("Writer Mismatches (With Writers): %lu\n\n", writer_mismatches);
+
+    // ------ Lookup With Writers During Rebuild ------ //
+    printf("Starting Lookup (During Rebuild)...\n");
+    double rebuild_time = timed_lookups(ht, kvs, numkvs, expected, num_threads, rounds, 1, num_writers, writer_base,
+                                        &mismatches, &writer_mismatches, &rebuilds, &writer_ops);
+    printf("Lookup Time (During Rebuild): %f seconds\n", rebuild_time);
+    printf("Lookup Mismatches (During Rebuild): %lu\n", mismatches);
+    printf("Shard Rebuilds Completed: %lu\n", rebuilds);
+    printf("Writer Updates Completed (During Rebuild): %lu\n", writer_ops);
+    printf("Writer Mismatches (During Rebuild): %lu\n\n", writer_mismatches);
+
+    // ------ Performance Summary ------ //
+    // Retained compares runs that differ only in the background rebuild
+    printf("Performance Summary:\n");
+    printf("---------------------\n");
+    printf("Lookup - Readers Only: %.2f Mops/s | With Writers: %.2f Mops/s | During Rebuild: %.2f Mops/s\n",
+           lookups / readers_time / 1e6, lookups / writers_time / 1e6, lookups / rebuild_time / 1e6);
+    printf("Rebuild - Retained Lookup Throughput: %.1f%%\n", 100.0 * writers_time / rebuild_time);
+
+    // Cleanup
+    free_sharded_hashtable(ht);
+    free(kvs);
+    free(expected);
+
+    return 0;
+}
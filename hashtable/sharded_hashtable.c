@@ -0,0 +1,457 @@
+#include "sharded_hashtable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <pthread.h>
+
+#define CACHE_LINE_SIZE 64
+
+// A reader record packs (shard index + 1) into the top bits and the shard
+// epoch it observed into the rest; 0 means the thread is not reading
+#define SHARD_ID_BITS 16
+#define EPOCH_BITS (64 - SHARD_ID_BITS)
+#define EPOCH_MASK ((UINT64_C(1) << EPOCH_BITS) - 1)
+#define MAX_SHARDS (UINT32_C(1) << (SHARD_ID_BITS - 1))
+
+// A rebuilt shard is at most 1 / MAX_LOAD_FACTOR_INV full
+#define MAX_LOAD_FACTOR_INV 2
+
+// Inserts rebuild a shard once more than MAX_USED_NUM / MAX_USED_DEN of its
+// slots hold entries or tombstones
+#define MAX_USED_NUM 3
+#define MAX_USED_DEN 4
+
+// Backing array of one shard; replaced as a whole on rebuild
+typedef struct {
+    KeyValue* slots;
+    size_t capacity;
+    uint64_t seed;
+    // Slots ever claimed by an insert (live entries plus tombstones), on its
+    // own cache line so insert traffic does not invalidate the fields above
+    size_t used __attribute__((aligned(CACHE_LINE_SIZE)));
+} __attribute__((aligned(CACHE_LINE_SIZE))) ShardTable;
+
+typedef struct {
+    // Read by every operation on the shard, written only by rebuilds
+    ShardTable* current;
+    uint64_t epoch;
+    // Writer gate, on its own cache line so insert/delete traffic does not
+    // invalidate the line lookups read
+    unsigned int active_writers __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned int rebuilding;
+} __attribute__((aligned(CACHE_LINE_SIZE))) Shard;
+
+typedef struct {
+    uint64_t pinned;
+} __attribute__((aligned(CACHE_LINE_SIZE))) ReaderRecord;
+
+struct ShardedHashtable {
+    Shard* shards;
+    unsigned int num_shards;
+    unsigned int shard_bits;
+    ReaderRecord* readers;
+};
+
+// Per-thread index into the reader records, claimed on first lookup and
+// released when the thread exits so the slot can be reused
+static __thread int reader_slot = -1;
+static unsigned int reader_slot_in_use[SHARDED_MAX_THREADS];
+static pthread_key_t reader_slot_key;
+static pthread_once_t reader_slot_key_once = PTHREAD_ONCE_INIT;
+
+static void* aligned_calloc(size_t count, size_t size, const char* what) {
+    void* ptr = aligned_alloc(CACHE_LINE_SIZE, count * size);
+    if (!ptr) {
+        perror(what);
+        exit(EXIT_FAILURE);
+    }
+    memset(ptr, 0, count * size);
+    return ptr;
+}
+
+// Shard selection hash; independent of the per-shard seed so a rebuild never
+// moves keys between shards
+static inline uint64_t hash_key_shard(hash_key_t key) {
+    return ((uint64_t)key) * UINT64_C(0x9E3779B97F4A7C15);
+}
+
+// Seeded slot hash used inside a shard
+static inline uint64_t hash_key_seeded(hash_key_t key, uint64_t seed) {
+    uint64_t h = (((uint64_t)key) ^ seed) * UINT64_C(0xC2B2AE3D27D4EB4F);
+    return h ^ (h >> 32);
+}
+
+// Reject a caller-supplied shard index outside 0 .. num_shards - 1
+static void check_shard_index(const ShardedHashtable* ht, unsigned int index) {
+    if (index >= ht->num_shards) {
+        fprintf(stderr, "Invalid shard index: %u (num shards %u)\n", index, ht->num_shards);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static inline unsigned int shard_index(const ShardedHashtable* ht, hash_key_t key) {
+    if (ht->shard_bits == 0) {
+        return 0;
+    }
+    return (unsigned int)(hash_key_shard(key) >> (64 - ht->shard_bits));
+}
+
+static ShardTable* create_shard_table(size_t capacity, uint64_t seed) {
+    ShardTable* table = (ShardTable*)aligned_calloc(1, sizeof(ShardTable), "Failed to allocate shard table");
+    table->slots = initialize_hashtable(capacity);
+    table->capacity = capacity;
+    table->seed = seed;
+    return table;
+}
+
+static void free_shard_table(ShardTable* table) {
+    free(table->slots);
+    free(table);
+}
+
+// Insert into a single shard table (linear probing, as in hashtable_insert).
+// Tombstones are probed past but never reused, so a concurrent insert of the
+// same key cannot land in an earlier slot; rebuilds drop them. Returns false
+// if every slot is taken.
+static bool shard_table_insert(ShardTable* table, hash_key_t key, value_t value) {
+    size_t mask = table->capacity - 1;
+    size_t slot = hash_key_seeded(key, table->seed) & mask;
+
+    for (size_t probes = 0; probes < table->capacity; ) {
+        hash_key_t prev_key = __atomic_load_n(&table->slots[slot].key, __ATOMIC_SEQ_CST);
+        if (prev_key == K_EMPTY) {
+            // Attempt to insert the key atomically
+            if (__atomic_compare_exchange_n(&table->slots[slot].key, &prev_key, key, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                __atomic_store_n(&table->slots[slot].value, value, __ATOMIC_SEQ_CST);
+                __atomic_fetch_add(&table->used, 1, __ATOMIC_RELAXED);
+                return true;
+            }
+            // Lost the race; re-examine the same slot
+            continue;
+        }
+        if (prev_key == key) {
+            // Key already exists; update the value
+            __atomic_store_n(&table->slots[slot].value, value, __ATOMIC_SEQ_CST);
+            return true;
+        }
+        slot = (slot + 1) & mask;
+        probes++;
+    }
+    return false;
+}
+
+// Lookup in a single shard table
+static value_t shard_table_lookup(const ShardTable* table, hash_key_t key) {
+    size_t mask = table->capacity - 1;
+    size_t slot = hash_key_seeded(key, table->seed) & mask;
+
+    for (size_t probes = 0; probes < table->capacity; ++probes) {
+        hash_key_t current_key = __atomic_load_n(&table->slots[slot].key, __ATOMIC_SEQ_CST);
+        if (current_key == key) {
+            return __atomic_load_n(&table->slots[slot].value, __ATOMIC_SEQ_CST);
+        }
+        if (current_key == K_EMPTY) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return (value_t)0; // Default value indicating not found
+}
+
+// Delete from a single shard table by replacing the key with a tombstone, so
+// keys further along the probe chain stay reachable
+static void shard_table_delete(ShardTable* table, hash_key_t key) {
+    size_t mask = table->capacity - 1;
+    size_t slot = hash_key_seeded(key, table->seed) & mask;
+
+    for (size_t probes = 0; probes < table->capacity; ++probes) {
+        hash_key_t current_key = __atomic_load_n(&table->slots[slot].key, __ATOMIC_SEQ_CST);
+        if (current_key == key) {
+            __atomic_store_n(&table->slots[slot].value, (value_t)0, __ATOMIC_SEQ_CST);
+            __atomic_store_n(&table->slots[slot].key, K_TOMBSTONE, __ATOMIC_SEQ_CST);
+            return;
+        }
+        if (current_key == K_EMPTY) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static inline bool is_live_key(hash_key_t key) {
+    return key != K_EMPTY && key != K_TOMBSTONE;
+}
+
+// Whether entries and tombstones together exceed the shard's used threshold
+static inline bool shard_table_over_used(ShardTable* table) {
+    return __atomic_load_n(&table->used, __ATOMIC_RELAXED) * MAX_USED_DEN > table->capacity * MAX_USED_NUM;
+}
+
+// Thread-exit destructor; the thread has no pinned records left by then
+static void release_reader_slot(void* slot_plus_one) {
+    unsigned int slot = (unsigned int)((uintptr_t)slot_plus_one - 1);
+    __atomic_store_n(&reader_slot_in_use[slot], 0, __ATOMIC_RELEASE);
+}
+
+static void create_reader_slot_key(void) {
+    if (pthread_key_create(&reader_slot_key, release_reader_slot) != 0) {
+        fprintf(stderr, "Failed to create reader slot key\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static int claim_reader_slot(void) {
+    pthread_once(&reader_slot_key_once, create_reader_slot_key);
+    for (unsigned int slot = 0; slot < SHARDED_MAX_THREADS; ++slot) {
+        unsigned int expected = 0;
+        if (__atomic_load_n(&reader_slot_in_use[slot], __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&reader_slot_in_use[slot], &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            pthread_setspecific(reader_slot_key, (void*)(uintptr_t)(slot + 1));
+            return (int)slot;
+        }
+    }
+    fprintf(stderr, "Too many concurrent reader threads (SHARDED_MAX_THREADS = %d)\n", SHARDED_MAX_THREADS);
+    exit(EXIT_FAILURE);
+}
+
+static ReaderRecord* current_reader(ShardedHashtable* ht) {
+    if (reader_slot < 0) {
+        reader_slot = claim_reader_slot();
+    }
+    return &ht->readers[reader_slot];
+}
+
+// Announce that this thread is about to read the shard. The epoch is
+// published before the table pointer is loaded, so a rebuild that bumps the
+// epoch after swapping the pointer either sees this record or is certain the
+// reader will load the new table.
+static ReaderRecord* reader_pin(ShardedHashtable* ht, unsigned int index) {
+    ReaderRecord* record = current_reader(ht);
+    uint64_t epoch = __atomic_load_n(&ht->shards[index].epoch, __ATOMIC_SEQ_CST);
+    uint64_t pinned = ((uint64_t)(index + 1) << EPOCH_BITS) | (epoch & EPOCH_MASK);
+    __atomic_store_n(&record->pinned, pinned, __ATOMIC_SEQ_CST);
+    return record;
+}
+
+static void reader_unpin(ReaderRecord* record) {
+    __atomic_store_n(&record->pinned, 0, __ATOMIC_RELEASE);
+}
+
+// Wait until no reader can still hold a table of the shard retired at epoch
+static void wait_for_readers(ShardedHashtable* ht, unsigned int index, uint64_t retired_epoch) {
+    uint64_t shard_id = (uint64_t)(index + 1);
+    for (unsigned int i = 0; i < SHARDED_MAX_THREADS; ++i) {
+        while (1) {
+            uint64_t pinned = __atomic_load_n(&ht->readers[i].pinned, __ATOMIC_SEQ_CST);
+            if ((pinned >> EPOCH_BITS) != shard_id || (pinned & EPOCH_MASK) > (retired_epoch & EPOCH_MASK)) {
+                break;
+            }
+        }
+    }
+}
+
+// Block while the shard is being rebuilt, then register as an active writer
+static void shard_writer_enter(Shard* shard) {
+    while (1) {
+        while (__atomic_load_n(&shard->rebuilding, __ATOMIC_SEQ_CST)) {
+        }
+        __atomic_fetch_add(&shard->active_writers, 1, __ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&shard->rebuilding, __ATOMIC_SEQ_CST)) {
+            return;
+        }
+        // A rebuild started in between; back off and wait for it
+        __atomic_fetch_sub(&shard->active_writers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void shard_writer_exit(Shard* shard) {
+    __atomic_fetch_sub(&shard->active_writers, 1, __ATOMIC_SEQ_CST);
+}
+
+// Rebuild one shard and reclaim its old array. With a non-NULL
+// expected_table the rebuild is skipped if that table was already replaced,
+// so inserts racing past the used threshold trigger a single rebuild.
+static void rebuild_shard(ShardedHashtable* ht, unsigned int index, size_t new_capacity, uint64_t new_seed,
+                          const ShardTable* expected_table) {
+    Shard* shard = &ht->shards[index];
+
+    // Close the writer gate (this also serializes rebuilds of the shard)
+    unsigned int expected = 0;
+    while (!__atomic_compare_exchange_n(&shard->rebuilding, &expected, 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        expected = 0;
+    }
+    // Drain writers that entered before the gate closed
+    while (__atomic_load_n(&shard->active_writers, __ATOMIC_SEQ_CST) != 0) {
+    }
+
+    ShardTable* old_table = shard->current;
+    if (expected_table && old_table != expected_table) {
+        __atomic_store_n(&shard->rebuilding, 0, __ATOMIC_SEQ_CST);
+        return;
+    }
+    size_t live = 0;
+    for (size_t i = 0; i < old_table->capacity; ++i) {
+        if (is_live_key(old_table->slots[i].key)) {
+            live++;
+        }
+    }
+    if (new_capacity == 0) {
+        new_capacity = old_table->capacity;
+    }
+    // Never rebuild above the maximum load factor, so the shard keeps room
+    // for new inserts and probing for missing keys stays short
+    size_t min_capacity = next_power_of_two(live * MAX_LOAD_FACTOR_INV);
+    if (min_capacity < 2) {
+        min_capacity = 2;
+    }
+    new_capacity = next_power_of_two(new_capacity);
+    if (new_capacity < min_capacity) {
+        new_capacity = min_capacity;
+    }
+
+    ShardTable* new_table = create_shard_table(new_capacity, new_seed);
+    for (size_t i = 0; i < old_table->capacity; ++i) {
+        if (is_live_key(old_table->slots[i].key)) {
+            shard_table_insert(new_table, old_table->slots[i].key, old_table->slots[i].value);
+        }
+    }
+
+    // Publish the new table, then advance the epoch; readers pinned at the
+    // old epoch or earlier may still be probing old_table
+    __atomic_store_n(&shard->current, new_table, __ATOMIC_SEQ_CST);
+    uint64_t retired_epoch = __atomic_fetch_add(&shard->epoch, 1, __ATOMIC_SEQ_CST);
+
+    // Writers only ever see the new table from here on
+    __atomic_store_n(&shard->rebuilding, 0, __ATOMIC_SEQ_CST);
+
+    wait_for_readers(ht, index, retired_epoch);
+    free_shard_table(old_table);
+}
+
+ShardedHashtable* initialize_sharded_hashtable(unsigned int num_shards, size_t capacity) {
+    num_shards = (unsigned int)next_power_of_two(num_shards);
+    if (num_shards > MAX_SHARDS) {
+        fprintf(stderr, "Too many shards: %u (max %u)\n", num_shards, (unsigned int)MAX_SHARDS);
+        exit(EXIT_FAILURE);
+    }
+
+    ShardedHashtable* ht = (ShardedHashtable*)malloc(sizeof(ShardedHashtable));
+    if (!ht) {
+        perror("Failed to allocate sharded hash table");
+        exit(EXIT_FAILURE);
+    }
+    ht->num_shards = num_shards;
+    ht->shard_bits = 0;
+    while ((1u << ht->shard_bits) < num_shards) {
+        ht->shard_bits++;
+    }
+    ht->shards = (Shard*)aligned_calloc(num_shards, sizeof(Shard), "Failed to allocate shards");
+    ht->readers = (ReaderRecord*)aligned_calloc(SHARDED_MAX_THREADS, sizeof(ReaderRecord), "Failed to allocate reader records");
+
+    size_t shard_capacity = next_power_of_two(capacity) / num_shards;
+    if (shard_capacity < 2) {
+        shard_capacity = 2;
+    }
+    for (unsigned int i = 0; i < num_shards; ++i) {
+        ht->shards[i].current = create_shard_table(shard_capacity, 0);
+    }
+    return ht;
+}
+
+void free_sharded_hashtable(ShardedHashtable* ht) {
+    for (unsigned int i = 0; i < ht->num_shards; ++i) {
+        free_shard_table(ht->shards[i].current);
+    }
+    free(ht->shards);
+    free(ht->readers);
+    free(ht);
+}
+
+unsigned int sharded_hashtable_num_shards(const ShardedHashtable* ht) {
+    return ht->num_shards;
+}
+
+size_t sharded_hashtable_shard_capacity(ShardedHashtable* ht, unsigned int index) {
+    check_shard_index(ht, index);
+    // Pinned like a lookup, since a concurrent rebuild may free the table
+    ReaderRecord* record = reader_pin(ht, index);
+    size_t capacity = __atomic_load_n(&ht->shards[index].current, __ATOMIC_SEQ_CST)->capacity;
+    reader_unpin(record);
+    return capacity;
+}
+
+unsigned int sharded_hashtable_shard_of(const ShardedHashtable* ht, hash_key_t key) {
+    return shard_index(ht, key);
+}
+
+// Insert a key-value pair into the sharded hash table
+void sharded_hashtable_insert(ShardedHashtable* ht, hash_key_t key, value_t value) {
+    unsigned int index = shard_index(ht, key);
+    Shard* shard = &ht->shards[index];
+
+    while (1) {
+        shard_writer_enter(shard);
+        ShardTable* table = __atomic_load_n(&shard->current, __ATOMIC_SEQ_CST);
+        bool inserted = shard_table_insert(table, key, value);
+        bool over_used = shard_table_over_used(table);
+        uint64_t seed = table->seed;
+        shard_writer_exit(shard);
+        // Past the used threshold, compact away tombstones (and grow if the
+        // live entries alone need it) before probe chains get long. A full
+        // shard, possible only if the threshold raced, takes the same path
+        // before retrying.
+        if (!inserted || over_used) {
+            rebuild_shard(ht, index, 0, seed, table);
+        }
+        if (inserted) {
+            return;
+        }
+    }
+}
+
+// Lookup a key in the sharded hash table
+value_t sharded_hashtable_lookup(ShardedHashtable* ht, hash_key_t key) {
+    unsigned int index = shard_index(ht, key);
+    ReaderRecord* record = reader_pin(ht, index);
+    value_t value = shard_table_lookup(__atomic_load_n(&ht->shards[index].current, __ATOMIC_SEQ_CST), key);
+    reader_unpin(record);
+    return value;
+}
+
+// Delete a key from the sharded hash table
+void sharded_hashtable_delete(ShardedHashtable* ht, hash_key_t key) {
+    Shard* shard = &ht->shards[shard_index(ht, key)];
+    shard_writer_enter(shard);
+    shard_table_delete(__atomic_load_n(&shard->current, __ATOMIC_SEQ_CST), key);
+    shard_writer_exit(shard);
+}
+
+// Batch insert key-value pairs
+void sharded_hashtable_insert_batch(ShardedHashtable* ht, KeyValue* kvs, unsigned int numkvs) {
+    #pragma omp parallel for schedule(static)
+    for (unsigned int i = 0; i < numkvs; ++i) {
+        sharded_hashtable_insert(ht, kvs[i].key, kvs[i].value);
+    }
+}
+
+// Batch lookup keys
+void sharded_hashtable_lookup_batch(ShardedHashtable* ht, KeyValue* kvs, unsigned int numkvs, value_t* results) {
+    #pragma omp parallel for schedule(static)
+    for (unsigned int i = 0; i < numkvs; ++i) {
+        results[i] = sharded_hashtable_lookup(ht, kvs[i].key);
+    }
+}
+
+// Batch delete keys
+void sharded_hashtable_delete_batch(ShardedHashtable* ht, KeyValue* kvs, unsigned int numkvs) {
+    #pragma omp parallel for schedule(static)
+    for (unsigned int i = 0; i < numkvs; ++i) {
+        sharded_hashtable_delete(ht, kvs[i].key);
+    }
+}
+
+void sharded_hashtable_rebuild_shard(ShardedHashtable* ht, unsigned int index, size_t new_capacity, uint64_t new_seed) {
+    check_shard_index(ht, index);
+    rebuild_shard(ht, index, new_capacity, new_seed, NULL);
+}
@@ -0,0 +1,69 @@
+#ifndef SHARDED_HASHTABLE_H
+#define SHARDED_HASHTABLE_H
+
+#include "hashtable.h"
+
+// Deleted-slot marker; like K_EMPTY it must never be used as a key
+#ifndef K_TOMBSTONE
+#define K_TOMBSTONE ((hash_key_t)(K_EMPTY - 1))
+#endif
+
+// Maximum number of live threads that have read from sharded hash tables; a
+// thread's reader slot is released when the thread exits
+#ifndef SHARDED_MAX_THREADS
+#define SHARDED_MAX_THREADS 256
+#endif
+
+// Sharded hash table handle. Keys are routed to one of num_shards
+// power-of-two sub-tables by the high bits of their hash. Each shard can be
+// rebuilt (resized and/or rehashed with a new seed) while other threads keep
+// using the table: lookups never take a lock, inserts and deletes only wait
+// while their own shard is being rebuilt, and the replaced array is freed
+// once no reader can still be probing it (per-shard epoch-based reclamation).
+typedef struct ShardedHashtable ShardedHashtable;
+
+// Create a sharded hash table with num_shards shards (rounded up to a power
+// of two) and a total capacity split evenly across them
+ShardedHashtable* initialize_sharded_hashtable(unsigned int num_shards, size_t capacity);
+
+// Free the sharded hash table; no other thread may be using it
+void free_sharded_hashtable(ShardedHashtable* ht);
+
+// Number of shards in the table
+unsigned int sharded_hashtable_num_shards(const ShardedHashtable* ht);
+
+// Current capacity of shard index (0 .. num_shards - 1)
+size_t sharded_hashtable_shard_capacity(ShardedHashtable* ht, unsigned int index);
+
+// Shard that owns a key
+unsigned int sharded_hashtable_shard_of(const ShardedHashtable* ht, hash_key_t key);
+
+// Insert a key-value pair into the sharded hash table. Once more than 3/4 of
+// a shard's slots hold entries or tombstones, the insert rebuilds the shard,
+// which drops tombstones and grows it if the live entries need more room.
+void sharded_hashtable_insert(ShardedHashtable* ht, hash_key_t key, value_t value);
+
+// Lookup a key in the sharded hash table (lock-free)
+value_t sharded_hashtable_lookup(ShardedHashtable* ht, hash_key_t key);
+
+// Delete a key from the sharded hash table
+void sharded_hashtable_delete(ShardedHashtable* ht, hash_key_t key);
+
+// Batch insert key-value pairs
+void sharded_hashtable_insert_batch(ShardedHashtable* ht, KeyValue* kvs, unsigned int numkvs);
+
+// Batch lookup keys
+void sharded_hashtable_lookup_batch(ShardedHashtable* ht, KeyValue* kvs, unsigned int numkvs, value_t* results);
+
+// Batch delete keys
+void sharded_hashtable_delete_batch(ShardedHashtable* ht, KeyValue* kvs, unsigned int numkvs);
+
+// Rebuild shard index (0 .. num_shards - 1) into a fresh array with the given
+// hash seed and swap it in. A new_capacity of 0 keeps the current capacity.
+// The capacity is rounded up to a power of two and never drops below
+// 2 * (live entries), so a rebuilt shard is at most half full even when asked
+// to shrink further.
+// Concurrent rebuilds of the same shard are serialized.
+void sharded_hashtable_rebuild_shard(ShardedHashtable* ht, unsigned int index, size_t new_capacity, uint64_t new_seed);
+
+#endif // SHARDED_HASHTABLE_H